@@ -3,8 +3,24 @@
 #include<string.h>
 #include<ctype.h>
 #include<math.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<time.h>
 /* The maximum permitted length of a gameboard width or height number */
 #define MAX_DIMENSIONAL_DIGITS 10
+/* The default time budget, in microseconds, for an automated player's move */
+#define DEFAULT_MOVE_BUDGET 1000
+/* The maximum time budget, in microseconds, which may be set for a move */
+#define MAX_MOVE_BUDGET 60000000
+/* The number of features describing a position to an evaluator */
+#define NUM_FEATURES 7
+/* The maximum number of positions rated together by an evaluator */
+#define EVALUATION_BATCH_SIZE 32
+/* The maximum number of hidden units an evaluator may have */
+#define MAX_HIDDEN_SIZE 4096
+/* The factor by which measured rating costs are multiplied to allow for the
+ * variation in how long rating takes */
+#define RATING_COST_MARGIN 2
 
 /* One of the two players in the game */
 typedef struct {
@@ -25,13 +41,112 @@ typedef struct {
     char playerIcon;
 } Square;
 
-/* A gameboard, composed of a grid of squares */
+/**
+ * The squares of a gameboard which have been written to since it was last
+ * rendered, along with the player icons shown when it was last rendered.
+ * Per-square arrays are indexed by (row * width + column).
+ */
+typedef struct {
+    Point *cells;
+    int count;
+    char *marked;
+    char *shownIcons;
+    int *rows;
+    char *rowMarked;
+} DirtyRegion;
+
+/**
+ * A gameboard, composed of a grid of squares.
+ * Writes to the grid are tracked in the dirty region, unless it is NULL.
+ */
 typedef struct {
     int height;
     int width;
     Square **grid;
+    DirtyRegion *dirtyRegion;
 } GameBoard;
 
+/* The immediate change in each player's score caused by a single move */
+typedef struct {
+    Point position;
+    int deltaO;
+    int deltaX;
+} MoveScore;
+
+/**
+ * A save file read in batch mode, along with the scores of its legal moves.
+ * Status is 0 if the file was scored, 3 if it could not be opened, or 4 if
+ * it had invalid contents.
+ */
+typedef struct {
+    char *filename;
+    int status;
+    int done;
+    char playerToActIcon;
+    MoveScore *moveScores;
+    int moveCount;
+} BatchEntry;
+
+/**
+ * The save files of a batch, shared between the worker threads which score
+ * them and the main thread which writes their results in order.
+ * Entries are held in a ring buffer of windowSize slots, so file i uses slot
+ * (i % windowSize) and may only be claimed once the results of file
+ * (i - windowSize) have been written.
+ */
+typedef struct {
+    char **filenames;
+    int fileCount;
+    BatchEntry *slots;
+    int windowSize;
+    int nextToClaim;
+    int nextToWrite;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} BatchQueue;
+
+/**
+ * The latencies, in microseconds, of each automated move made in a game,
+ * along with how many of these moves had a time budget and how many of
+ * those went over it.
+ */
+typedef struct {
+    long *samples;
+    int count;
+    int capacity;
+    int budgetedCount;
+    int overruns;
+} LatencyLog;
+
+/**
+ * The longest times, in microseconds, taken so far during a move to play a
+ * move on a copy of the gameboard and extract its features, and to rate a
+ * batch of features with an evaluator.
+ */
+typedef struct {
+    long extraction;
+    long inference;
+} RatingCost;
+
+/**
+ * Rates positions from their features, where higher ratings are better for
+ * the player the features were extracted for.
+ * Evaluators are either linear (hiddenSize is 0), rating positions as the
+ * weighted sum of their features, or a multilayer perceptron with a single
+ * ReLU hidden layer of hiddenSize units.
+ * Hidden weights are stored row-major, one row of NUM_FEATURES per unit.
+ * Output weights hold one weight per hidden unit, or per feature if linear.
+ */
+typedef struct Evaluator {
+    void (*evaluate)(const struct Evaluator *evaluator,
+            const float *features, int count, float *ratings);
+    int hiddenSize;
+    float *hiddenWeights;
+    float *hiddenBiases;
+    float *outputWeights;
+    float outputBias;
+} Evaluator;
+
 /**
  * Represents the four directions one can use to navigate the gameboard:
  * Right, Down, Left, Up (respectively)
@@ -41,6 +156,7 @@ const char DIRECTIONS[4] = {'r', 'd', 'l', 'u'};
 void place_on_grid(Player player, Point position, GameBoard *gameBoard);
 void shift_stones(Point position, GameBoard *gameBoard, char direction);
 void print_grid(GameBoard gameBoard, FILE *fp);
+void print_row(GameBoard gameBoard, int row, FILE *fp);
 void sum_scores(Player *player, GameBoard gameBoard);
 void save_file(GameBoard gameBoard, Player playerToAct, char *filename);
 void load_file(FILE *fp, int *height, int *width, char *playerToActIcon,
@@ -50,12 +166,109 @@ int is_valid_position(Point position, GameBoard gameBoard);
 int is_interior_full(GameBoard gameBoard);
 int is_corner(Point position, GameBoard gameBoard);
 int infer_input_type(char *input);
+int score_all_moves(char playerIcon, GameBoard gameBoard,
+        MoveScore *moveScores);
+int run_batch(int fileCount, char **filenames);
+char get_inward_direction(Point position, GameBoard gameBoard);
+void free_grid(GameBoard gameBoard);
+void mark_dirty(Point position, GameBoard *gameBoard);
+void print_changes(GameBoard *gameBoard, char renderMode, FILE *fp);
+DirtyRegion *create_dirty_region(GameBoard gameBoard);
+void free_dirty_region(DirtyRegion *dirtyRegion);
+int compare_ints(const void *a, const void *b);
+void record_latency(LatencyLog *latencyLog, long latency, long budget);
+void print_latency_summary(LatencyLog latencyLog, FILE *fp);
+int compare_longs(const void *a, const void *b);
+long get_time_micros(void);
+void *score_batch(void *arg);
+void score_batch_entry(BatchEntry *entry);
+void write_batch_entry(BatchEntry *entry);
 Point get_adjacent_position(Point position, char direction);
+MoveScore score_move(char playerIcon, Point position, GameBoard gameBoard);
 Point make_move_bot_0(Player bot, GameBoard *gameBoard);
 Point make_move_bot_1(Player bot, GameBoard *gameBoard);
+Point make_move_bot_2(Player bot, GameBoard *gameBoard, long deadline,
+        const Evaluator *evaluator);
+int rate_moves(Player bot, GameBoard gameBoard, const Evaluator *evaluator,
+        Point *positions, int count, float *ratings, long deadline,
+        RatingCost *ratingCost);
+void extract_features(char playerIcon, GameBoard gameBoard, float *features,
+        int index);
+void evaluate_linear(const Evaluator *evaluator, const float *features,
+        int count, float *ratings);
+void evaluate_mlp(const Evaluator *evaluator, const float *features,
+        int count, float *ratings);
+int load_evaluator(FILE *fp, Evaluator *evaluator);
+int read_weight(FILE *fp, float *weight);
+void free_evaluator(Evaluator *evaluator);
 Square get_square(Point point, GameBoard gameBoard);
 
 int main(int argc, char** argv) {
+    // Read any options preceding the positional args. Reading stops at the
+    // first arg which is not a known option, leaving it to be checked as a
+    // player type.
+    int batchMode = 0;
+    long moveBudget = DEFAULT_MOVE_BUDGET;
+    int budgetSet = 0;
+    // How to show the board after each move: 'f' prints the full board,
+    // 'r' prints only changed rows and 'd' prints changed squares
+    char renderMode = 'f';
+    Evaluator *evaluator = NULL;
+    int argIndex;
+    for (argIndex = 1; argIndex < argc; argIndex++) {
+        char *option = argv[argIndex];
+        if (!strcmp(option, "-b")) {
+            batchMode = 1;
+            continue;
+        }
+        if (strcmp(option, "-t") && strcmp(option, "-r") &&
+                strcmp(option, "-w")) {
+            break;
+        }
+        // Every other option is followed by a value
+        char *optarg = ++argIndex < argc ? argv[argIndex] : "";
+        if (option[1] == 'r' && (!strcmp(optarg, "full") ||
+                !strcmp(optarg, "rows") || !strcmp(optarg, "diff"))) {
+            renderMode = optarg[0];
+            continue;
+        }
+        if (option[1] == 'w') {
+            // Load the evaluator used to rate type 2 players' moves
+            FILE *weightsFile = fopen(optarg, "r");
+            evaluator = malloc(sizeof(Evaluator));
+            if (weightsFile == NULL ||
+                    !load_evaluator(weightsFile, evaluator)) {
+                fprintf(stderr, "Invalid weights file\n");
+                exit(7);
+            }
+            fclose(weightsFile);
+            continue;
+        }
+        if (option[1] == 't') {
+            // The time budget is a positive number of microseconds, no more
+            // than MAX_MOVE_BUDGET so that deadlines cannot overflow
+            char *end;
+            moveBudget = strtol(optarg, &end, 10);
+            if (isdigit(optarg[0]) && *end == '\0' && moveBudget > 0 &&
+                    moveBudget <= MAX_MOVE_BUDGET) {
+                budgetSet = 1;
+                continue;
+            }
+        }
+        fprintf(stderr, "Usage: push2310 typeO typeX fname\n");
+        exit(1);
+    }
+    argc -= argIndex - 1;
+    argv += argIndex - 1;
+    if (batchMode) {
+        // Score every legal move of each passed save file and exit
+        if (argc < 2) {
+            fprintf(stderr, "Usage: push2310 -b fname...\n");
+            exit(1);
+        }
+        return run_batch(argc - 1, argv + 1);
+    }
+
     // Verify args and assign pointer to the passed save file
     if (argc != 4) {
         fprintf(stderr, "Usage: push2310 typeO typeX fname\n");
@@ -63,7 +276,7 @@ int main(int argc, char** argv) {
     }
     for (int i = 1; i <= 2; i++) {
         if (strcmp(argv[i], "0") && strcmp(argv[i], "1") && 
-                strcmp(argv[i], "H")) {
+                strcmp(argv[i], "2") && strcmp(argv[i], "H")) {
             fprintf(stderr, "Invalid player type\n");
             exit(2);
         }
@@ -88,7 +301,7 @@ int main(int argc, char** argv) {
 
 
     fclose(fp);
-    GameBoard gameBoard = {height, width, grid};
+    GameBoard gameBoard = {height, width, grid, NULL};
     if (is_interior_full(gameBoard)) {
         fprintf(stderr, "Full board in load\n");
         exit(6);
@@ -98,10 +311,21 @@ int main(int argc, char** argv) {
     Player *playerToAct = playerToActIcon == 'O' ? &playerO : &playerX;
 
     print_grid(gameBoard, stdout);
+    if (renderMode != 'f') {
+        gameBoard.dirtyRegion = create_dirty_region(gameBoard);
+    }
+    // Only measure move latency when moves are being timed
+    int timed = budgetSet || playerO.playerType == '2' ||
+            playerX.playerType == '2';
+    LatencyLog latencyLog = {NULL, 0, 0, 0, 0};
     
     // Play game
     while (1) {
         Point movePosition;
+        // Automated moves are timed up until the move is made, excluding
+        // any output, which may block
+        long moveStart = get_time_micros();
+        long moveEnd = moveStart;
         if (playerToAct->playerType == 'H') {
             // Prompt for and process human input
             char *input = malloc(sizeof(char));
@@ -140,15 +364,33 @@ int main(int argc, char** argv) {
         } else if (playerToAct->playerType == '0') {
             // Place a stone according to automated player type 0's algorithm
             movePosition = make_move_bot_0(*playerToAct, &gameBoard);
+            moveEnd = get_time_micros();
             printf("Player %c placed at %d %d\n", playerToAct->playerIcon, 
                     movePosition.row, movePosition.column);
-        } else {
+        } else if (playerToAct->playerType == '1') {
             // Place a stone according to automated player type 1's algorithm
             movePosition = make_move_bot_1(*playerToAct, &gameBoard);
+            moveEnd = get_time_micros();
+            printf("Player %c placed at %d %d\n", playerToAct->playerIcon, 
+                    movePosition.row, movePosition.column);
+        } else {
+            // Place a stone according to automated player type 2's algorithm
+            movePosition = make_move_bot_2(*playerToAct, &gameBoard,
+                    moveStart + moveBudget, evaluator);
+            moveEnd = get_time_micros();
             printf("Player %c placed at %d %d\n", playerToAct->playerIcon, 
                     movePosition.row, movePosition.column);
         }
-        print_grid(gameBoard, stdout);
+        if (timed && playerToAct->playerType != 'H') {
+            // Only type 2 players' moves are made within the budget
+            record_latency(&latencyLog, moveEnd - moveStart,
+                    playerToAct->playerType == '2' ? moveBudget : 0);
+        }
+        if (renderMode == 'f') {
+            print_grid(gameBoard, stdout);
+        } else {
+            print_changes(&gameBoard, renderMode, stdout);
+        }
         if (is_interior_full(gameBoard)) {
             break;
         }
@@ -165,12 +407,25 @@ int main(int argc, char** argv) {
         printf("Winners: O X\n");
     }
     
+    print_latency_summary(latencyLog, stderr);
+    
     // Free gameboard pointers and exit
-    for (int i = 0; i < height; i++) {
+    free(latencyLog.samples);
+    free_evaluator(evaluator);
+    free_dirty_region(gameBoard.dirtyRegion);
+    free_grid(gameBoard);
+    return 0;
+}
+
+/**
+ * Frees the grid of this gameboard, along with each of its rows.
+ * @param gameBoard of which to free the grid.
+ */
+void free_grid(GameBoard gameBoard) {
+    for (int i = 0; i < gameBoard.height; i++) {
         free(gameBoard.grid[i]);
     }
     free(gameBoard.grid);
-    return 0;
 }
 
 /**
@@ -323,16 +578,34 @@ void place_on_grid(Player player, Point position, GameBoard *gameBoard) {
     // Place the stone
     gameBoard->grid[position.row][position.column].playerIcon =
             player.playerIcon;
+    mark_dirty(position, gameBoard);
     // If position is on an edge, shift the other stones appropriately
+    char direction = get_inward_direction(position, *gameBoard);
+    if (direction) {
+        shift_stones(position, gameBoard, direction);
+    }
+}
+
+/**
+ * Gets the direction in which a stone placed at the passed position would be
+ * pushed, i.e. the direction facing away from the edge this position is on.
+ * Does not protect against invalid positions.
+ * @param position on the gameboard to find the inward-facing direction of.
+ * @param gameBoard on which the position lies.
+ * @return the inward-facing direction (see @DIRECTIONS), or '\0' if the
+ * position is on the interior of the gameboard.
+ */
+char get_inward_direction(Point position, GameBoard gameBoard) {
     if (position.row == 0) {
-        shift_stones(position, gameBoard, 'd');
-    } else if (position.row == gameBoard->height - 1) {
-        shift_stones(position, gameBoard, 'u');
+        return 'd';
+    } else if (position.row == gameBoard.height - 1) {
+        return 'u';
     } else if (position.column == 0) {
-        shift_stones(position, gameBoard, 'r');
-    } else if (position.column == gameBoard->width - 1) {
-        shift_stones(position, gameBoard, 'l');
+        return 'r';
+    } else if (position.column == gameBoard.width - 1) {
+        return 'l';
     }
+    return '\0';
 }
 
 /**
@@ -357,6 +630,27 @@ void shift_stones(Point position, GameBoard *gameBoard, char direction) {
     gameBoard->grid[adjacentPosition.row][adjacentPosition.column].playerIcon
             = get_square(position, *gameBoard).playerIcon;
     gameBoard->grid[position.row][position.column].playerIcon = '.';
+    mark_dirty(adjacentPosition, gameBoard);
+    mark_dirty(position, gameBoard);
+}
+
+/**
+ * Records that the square at this position has been written to, if this
+ * gameboard is tracking a dirty region. Each square is recorded at most once
+ * between renders.
+ * @param position of the square that was written to.
+ * @param gameBoard pointer to the gameboard containing the square.
+ */
+void mark_dirty(Point position, GameBoard *gameBoard) {
+    DirtyRegion *dirtyRegion = gameBoard->dirtyRegion;
+    if (dirtyRegion == NULL) {
+        return;
+    }
+    int index = position.row * gameBoard->width + position.column;
+    if (!dirtyRegion->marked[index]) {
+        dirtyRegion->marked[index] = 1;
+        dirtyRegion->cells[dirtyRegion->count++] = position;
+    }
 }
 
 /**
@@ -396,18 +690,132 @@ Point get_adjacent_position(Point position, char direction) {
  * @param fp pointer to the file to print the grid to.
  */
 void print_grid(GameBoard gameBoard, FILE *fp) {
+    for (int row = 0; row < gameBoard.height; row++) {
+        print_row(gameBoard, row, fp);
+    }
+}
+
+/**
+ * Prints a single row of the grid of this gameboard, followed by a new line,
+ * to the file pointed to by the given pointer.
+ * @param gameBoard of which to print the row.
+ * @param row the index of the row to print.
+ * @param fp pointer to the file to print the row to.
+ */
+void print_row(GameBoard gameBoard, int row, FILE *fp) {
+    for (int column = 0; column < gameBoard.width; column++) {
+        Point position = {row, column};
+        if (is_corner(position, gameBoard)) {
+            fprintf(fp, "  ");
+        } else {
+            Square square = get_square(position, gameBoard);
+            fprintf(fp, "%d%c", square.value, square.playerIcon);
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+/**
+ * Creates a dirty region for this gameboard with no dirty squares, treating
+ * the current contents of the grid as already rendered.
+ * @param gameBoard for which to track written squares.
+ * @return pointer to the new dirty region, to be freed with
+ * @free_dirty_region.
+ */
+DirtyRegion *create_dirty_region(GameBoard gameBoard) {
+    int size = gameBoard.height * gameBoard.width;
+    DirtyRegion *dirtyRegion = malloc(sizeof(DirtyRegion));
+    dirtyRegion->cells = malloc(size * sizeof(Point));
+    dirtyRegion->count = 0;
+    dirtyRegion->marked = calloc(size, sizeof(char));
+    dirtyRegion->shownIcons = malloc(size * sizeof(char));
+    dirtyRegion->rows = malloc(gameBoard.height * sizeof(int));
+    dirtyRegion->rowMarked = calloc(gameBoard.height, sizeof(char));
     for (int row = 0; row < gameBoard.height; row++) {
         for (int column = 0; column < gameBoard.width; column++) {
-            Point position = {row, column};
-            if (is_corner(position, gameBoard)) {
-                fprintf(fp, "  ");
-            } else {
-                Square square = get_square(position, gameBoard);
-                fprintf(fp, "%d%c", square.value, square.playerIcon);
-            }
+            dirtyRegion->shownIcons[row * gameBoard.width + column] =
+                    gameBoard.grid[row][column].playerIcon;
+        }
+    }
+    return dirtyRegion;
+}
+
+/**
+ * Frees this dirty region and all of its arrays. Does nothing if NULL.
+ * @param dirtyRegion pointer to the dirty region to free.
+ */
+void free_dirty_region(DirtyRegion *dirtyRegion) {
+    if (dirtyRegion == NULL) {
+        return;
+    }
+    free(dirtyRegion->cells);
+    free(dirtyRegion->marked);
+    free(dirtyRegion->shownIcons);
+    free(dirtyRegion->rows);
+    free(dirtyRegion->rowMarked);
+    free(dirtyRegion);
+}
+
+/**
+ * Prints the squares of this gameboard which have changed since it was last
+ * rendered to the file pointed to by the given pointer, then clears its dirty
+ * region. Squares which were written to but hold the same icon as before are
+ * not considered changed.
+ * In diff mode ('d'), prints one "R C square" record per changed square,
+ * e.g. "2 3 6O", followed by an empty line.
+ * In rows mode ('r'), prints each row containing a changed square in
+ * ascending order, in the format of @print_grid but prefixed by "R:".
+ * The gameboard must be tracking a dirty region.
+ * @param gameBoard pointer to the gameboard to render.
+ * @param renderMode 'd' for diff mode or 'r' for rows mode.
+ * @param fp pointer to the file to print the changes to.
+ */
+void print_changes(GameBoard *gameBoard, char renderMode, FILE *fp) {
+    DirtyRegion *dirtyRegion = gameBoard->dirtyRegion;
+    int rowCount = 0;
+    for (int i = 0; i < dirtyRegion->count; i++) {
+        Point position = dirtyRegion->cells[i];
+        int index = position.row * gameBoard->width + position.column;
+        dirtyRegion->marked[index] = 0;
+        Square square = get_square(position, *gameBoard);
+        if (square.playerIcon == dirtyRegion->shownIcons[index]) {
+            continue;
+        }
+        dirtyRegion->shownIcons[index] = square.playerIcon;
+        if (renderMode == 'd') {
+            fprintf(fp, "%d %d %d%c\n", position.row, position.column,
+                    square.value, square.playerIcon);
+        } else if (!dirtyRegion->rowMarked[position.row]) {
+            dirtyRegion->rowMarked[position.row] = 1;
+            dirtyRegion->rows[rowCount++] = position.row;
         }
+    }
+    dirtyRegion->count = 0;
+    if (renderMode == 'd') {
         fprintf(fp, "\n");
+        return;
     }
+    // Print the changed rows in order
+    qsort(dirtyRegion->rows, rowCount, sizeof(int), compare_ints);
+    for (int i = 0; i < rowCount; i++) {
+        int row = dirtyRegion->rows[i];
+        dirtyRegion->rowMarked[row] = 0;
+        fprintf(fp, "%d:", row);
+        print_row(*gameBoard, row, fp);
+    }
+}
+
+/**
+ * Compares two ints for sorting in ascending order with qsort.
+ * @param a pointer to the first int.
+ * @param b pointer to the second int.
+ * @return a negative, zero or positive value if a is less than, equal to or
+ * greater than b respectively.
+ */
+int compare_ints(const void *a, const void *b) {
+    int first = *(const int *) a;
+    int second = *(const int *) b;
+    return (first > second) - (first < second);
 }
 
 /**
@@ -699,6 +1107,440 @@ Point make_move_bot_1(Player bot, GameBoard *gameBoard) {
     return maxPosition;
 }
 
+/**
+ * Logic for automated player type 2 to make a move on the given gameboard
+ * before the given deadline.
+ *
+ * Scan the edges, then the interior, of the board left-to-right top-to-bottom
+ * for valid positions to place a stone, and rate each one (see @rate_moves).
+ * With an evaluator, every position after the first is collected into
+ * batches of up to EVALUATION_BATCH_SIZE positions which are rated together.
+ * Edges are scanned first since only edge moves can take squares from the
+ * opponent.
+ *
+ * Once the deadline passes, stop scanning and place a stone at the highest
+ * rated position found so far. The first valid position is always rated
+ * before stopping, so a move is made even if the deadline has already passed.
+ * With an evaluator, the time taken to rate positions is measured as they
+ * are rated, and scanning stops early enough that rating one more batch
+ * would still finish before the deadline (see @rate_moves).
+ * If a tie is found, place a stone at the first position found with this
+ * rating.
+ *
+ * @param bot the automated player to make the move.
+ * @param gameBoard pointer to the gameboard for the bot to make a move on.
+ * @param deadline time, as returned by @get_time_micros, by which to stop
+ * searching for a better position.
+ * @param evaluator pointer to the evaluator to rate positions with, or NULL
+ * to rate them by change in score.
+ * @return the position of the placed stone, or a (0,0) position if no valid
+ * position was found.
+ */
+Point make_move_bot_2(Player bot, GameBoard *gameBoard, long deadline,
+        const Evaluator *evaluator) {
+    Point candidates[EVALUATION_BATCH_SIZE];
+    float ratings[EVALUATION_BATCH_SIZE];
+    int candidateCount = 0;
+    Point bestPosition = {0, 0};
+    float bestRating = 0;
+    int found = 0;
+    RatingCost ratingCost = {0, 0};
+    int squareCount = gameBoard->height * gameBoard->width;
+    // Visit each square twice, considering only edges on the first pass and
+    // only the interior on the second. The final iteration rates any
+    // candidates remaining in a partial batch.
+    for (int i = 0; i <= 2 * squareCount; i++) {
+        if (found && get_time_micros() + RATING_COST_MARGIN *
+                (ratingCost.extraction + ratingCost.inference) >= deadline) {
+            break;
+        }
+        // Rate the first candidate on its own, and only batch the rest when
+        // rating them with an evaluator
+        int batchSize = evaluator && found ? EVALUATION_BATCH_SIZE : 1;
+        if (i < 2 * squareCount) {
+            int pass = i / squareCount;
+            Point position = {i % squareCount / gameBoard->width,
+                    i % gameBoard->width};
+            int isInterior = !get_inward_direction(position, *gameBoard);
+            if (isInterior == pass &&
+                    is_valid_position(position, *gameBoard)) {
+                candidates[candidateCount++] = position;
+            }
+            if (candidateCount < batchSize) {
+                continue;
+            }
+        } else if (candidateCount == 0) {
+            break;
+        }
+        // Rate the batch of candidates and keep the best so far
+        int ratedCount = rate_moves(bot, *gameBoard, evaluator, candidates,
+                candidateCount, ratings, deadline, &ratingCost);
+        for (int j = 0; j < ratedCount; j++) {
+            if (!found || ratings[j] > bestRating) {
+                bestRating = ratings[j];
+                bestPosition = candidates[j];
+                found = 1;
+            }
+        }
+        if (ratedCount < candidateCount) {
+            // The deadline passed part way through the batch
+            break;
+        }
+        candidateCount = 0;
+    }
+    if (found) {
+        place_on_grid(bot, bestPosition, gameBoard);
+    }
+    return bestPosition;
+}
+
+/**
+ * Rates the given positions, in order, by how good it would be for the given
+ * bot to place a stone there, stopping early so as to finish by the
+ * deadline. The first position is always rated.
+ * Without an evaluator, a position is rated by the change in the bot's score
+ * less the change in the opponent's score (see @score_move). Otherwise, the
+ * move is played on a copy of the gameboard, and the features of every
+ * resulting position are rated together by the evaluator. In this case, no
+ * more positions are added to the batch once extracting the features of one
+ * more position and then rating the batch would not finish before the
+ * deadline, according to the costs measured so far and RATING_COST_MARGIN.
+ * Does not protect against invalid positions.
+ * @param bot the automated player to make the move.
+ * @param gameBoard on which the moves would be made.
+ * @param evaluator pointer to the evaluator to rate positions with, or NULL.
+ * @param positions at which the bot could place a stone.
+ * @param count the number of positions to rate, at most
+ * EVALUATION_BATCH_SIZE.
+ * @param ratings array in which to store the rating of each position.
+ * @param deadline time, as returned by @get_time_micros, by which to finish
+ * rating positions.
+ * @param ratingCost pointer to the longest costs measured so far during this
+ * move, which are updated with the costs measured while rating.
+ * @return the number of positions rated, which are the first positions given.
+ */
+int rate_moves(Player bot, GameBoard gameBoard, const Evaluator *evaluator,
+        Point *positions, int count, float *ratings, long deadline,
+        RatingCost *ratingCost) {
+    int ratedCount = 0;
+    if (evaluator == NULL) {
+        for (; ratedCount < count; ratedCount++) {
+            if (ratedCount > 0 && get_time_micros() >= deadline) {
+                break;
+            }
+            int i = ratedCount;
+            MoveScore moveScore = score_move(
+                    bot.playerIcon, positions[i], gameBoard);
+            ratings[i] = bot.playerIcon == 'O' ?
+                    moveScore.deltaO - moveScore.deltaX :
+                    moveScore.deltaX - moveScore.deltaO;
+        }
+        return ratedCount;
+    }
+    // Play each move on an untracked copy of the gameboard
+    GameBoard copy = {gameBoard.height, gameBoard.width,
+            malloc(gameBoard.height * sizeof(Square *)), NULL};
+    for (int row = 0; row < copy.height; row++) {
+        copy.grid[row] = malloc(copy.width * sizeof(Square));
+    }
+    // Unused positions of the batch are left as zero
+    float features[NUM_FEATURES * EVALUATION_BATCH_SIZE] = {0};
+    for (; ratedCount < count; ratedCount++) {
+        long extractionStart = get_time_micros();
+        if (ratedCount > 0 && extractionStart + RATING_COST_MARGIN *
+                (ratingCost->extraction + ratingCost->inference) >= deadline) {
+            break;
+        }
+        for (int row = 0; row < copy.height; row++) {
+            memcpy(copy.grid[row], gameBoard.grid[row],
+                    copy.width * sizeof(Square));
+        }
+        place_on_grid(bot, positions[ratedCount], &copy);
+        extract_features(bot.playerIcon, copy, features, ratedCount);
+        long extraction = get_time_micros() - extractionStart;
+        if (extraction > ratingCost->extraction) {
+            ratingCost->extraction = extraction;
+        }
+    }
+    free_grid(copy);
+    long inferenceStart = get_time_micros();
+    evaluator->evaluate(evaluator, features, ratedCount, ratings);
+    long inference = get_time_micros() - inferenceStart;
+    if (inference > ratingCost->inference) {
+        ratingCost->inference = inference;
+    }
+    return ratedCount;
+}
+
+/**
+ * Describes this gameboard from the perspective of the given player as
+ * NUM_FEATURES numbers, namely: the player's score, the opponent's score,
+ * the number of stones held by the player, the number of stones held by the
+ * opponent, the total value of empty interior squares, the number of empty
+ * interior squares, and the number of edge squares a stone could be pushed
+ * from.
+ * Features of a batch are stored feature-major, so that feature f of
+ * position i is at features[f * EVALUATION_BATCH_SIZE + i].
+ * @param playerIcon icon of the player to describe the gameboard for.
+ * @param gameBoard to describe.
+ * @param features array of a batch's features in which to store this
+ * gameboard's features.
+ * @param index the index of this gameboard's position in the batch.
+ */
+void extract_features(char playerIcon, GameBoard gameBoard, float *features,
+        int index) {
+    float values[NUM_FEATURES] = {0};
+    for (int row = 0; row < gameBoard.height; row++) {
+        for (int column = 0; column < gameBoard.width; column++) {
+            Point position = {row, column};
+            if (is_corner(position, gameBoard)) {
+                continue;
+            }
+            Square square = get_square(position, gameBoard);
+            if (square.playerIcon == playerIcon) {
+                values[0] += square.value;
+                values[2]++;
+            } else if (square.playerIcon != '.') {
+                values[1] += square.value;
+                values[3]++;
+            } else if (!get_inward_direction(position, gameBoard)) {
+                values[4] += square.value;
+                values[5]++;
+            } else if (is_valid_position(position, gameBoard)) {
+                values[6]++;
+            }
+        }
+    }
+    for (int i = 0; i < NUM_FEATURES; i++) {
+        features[i * EVALUATION_BATCH_SIZE + index] = values[i];
+    }
+}
+
+/**
+ * Rates a batch of positions with this linear evaluator.
+ * The inner loops always run over all EVALUATION_BATCH_SIZE contiguous
+ * positions of the feature-major batch, accumulating into a local array, so
+ * that gcc vectorises them at -O2.
+ * @param evaluator pointer to the linear evaluator.
+ * @param features of the batch, see @extract_features. Unused positions of
+ * the batch must be zeroed.
+ * @param count the number of positions in the batch.
+ * @param ratings array in which to store the rating of each position.
+ */
+void evaluate_linear(const Evaluator *evaluator, const float *features,
+        int count, float *ratings) {
+    float output[EVALUATION_BATCH_SIZE];
+    float bias = evaluator->outputBias;
+    for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+        output[i] = bias;
+    }
+    for (int f = 0; f < NUM_FEATURES; f++) {
+        const float *feature = features + f * EVALUATION_BATCH_SIZE;
+        float weight = evaluator->outputWeights[f];
+        for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+            output[i] += weight * feature[i];
+        }
+    }
+    memcpy(ratings, output, count * sizeof(float));
+}
+
+/**
+ * Rates a batch of positions with this multilayer perceptron evaluator,
+ * computing one hidden unit at a time across the whole batch.
+ * The inner loops always run over all EVALUATION_BATCH_SIZE contiguous
+ * positions of the feature-major batch, accumulating into local arrays, so
+ * that gcc vectorises them at -O2.
+ * @param evaluator pointer to the multilayer perceptron evaluator.
+ * @param features of the batch, see @extract_features. Unused positions of
+ * the batch must be zeroed.
+ * @param count the number of positions in the batch.
+ * @param ratings array in which to store the rating of each position.
+ */
+void evaluate_mlp(const Evaluator *evaluator, const float *features,
+        int count, float *ratings) {
+    float output[EVALUATION_BATCH_SIZE];
+    float hidden[EVALUATION_BATCH_SIZE];
+    float outputBias = evaluator->outputBias;
+    for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+        output[i] = outputBias;
+    }
+    for (int h = 0; h < evaluator->hiddenSize; h++) {
+        const float *weights = evaluator->hiddenWeights + h * NUM_FEATURES;
+        float hiddenBias = evaluator->hiddenBiases[h];
+        for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+            hidden[i] = hiddenBias;
+        }
+        for (int f = 0; f < NUM_FEATURES; f++) {
+            const float *feature = features + f * EVALUATION_BATCH_SIZE;
+            float weight = weights[f];
+            for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+                hidden[i] += weight * feature[i];
+            }
+        }
+        // Apply the ReLU activation and add this unit's output
+        float weight = evaluator->outputWeights[h];
+        for (int i = 0; i < EVALUATION_BATCH_SIZE; i++) {
+            output[i] += weight * (hidden[i] > 0 ? hidden[i] : 0);
+        }
+    }
+    memcpy(ratings, output, count * sizeof(float));
+}
+
+/**
+ * Reads evaluator weights from a weights file and stores them in the
+ * evaluator pointed to by the passed pointer.
+ * Weights files begin with a line "F H", where F must equal NUM_FEATURES and
+ * H is the number of hidden units, at most MAX_HIDDEN_SIZE, or 0 for a
+ * linear evaluator. This is
+ * followed by whitespace-separated numbers: for linear evaluators, F weights
+ * then a bias; otherwise H rows of F hidden weights, H hidden biases, H
+ * output weights, then an output bias. Every weight and bias must be finite.
+ * @param fp pointer to the weights file to read from.
+ * @param evaluator pointer to the evaluator in which to store the weights.
+ * @return 1 if the weights file was valid, else 0.
+ */
+int load_evaluator(FILE *fp, Evaluator *evaluator) {
+    evaluator->hiddenWeights = NULL;
+    evaluator->hiddenBiases = NULL;
+    evaluator->outputWeights = NULL;
+    int featureCount, hiddenSize;
+    if (fscanf(fp, "%d %d", &featureCount, &hiddenSize) != 2 ||
+            featureCount != NUM_FEATURES || hiddenSize < 0 ||
+            hiddenSize > MAX_HIDDEN_SIZE) {
+        return 0;
+    }
+    evaluator->hiddenSize = hiddenSize;
+    evaluator->evaluate = hiddenSize ? evaluate_mlp : evaluate_linear;
+    size_t hiddenWeightCount = (size_t) hiddenSize * NUM_FEATURES;
+    size_t outputSize = hiddenSize ? (size_t) hiddenSize : NUM_FEATURES;
+    if (hiddenSize) {
+        evaluator->hiddenWeights = malloc(hiddenWeightCount * sizeof(float));
+        evaluator->hiddenBiases = malloc(hiddenSize * sizeof(float));
+        if (evaluator->hiddenWeights == NULL ||
+                evaluator->hiddenBiases == NULL) {
+            return 0;
+        }
+    }
+    evaluator->outputWeights = malloc(outputSize * sizeof(float));
+    if (evaluator->outputWeights == NULL) {
+        return 0;
+    }
+    // Read every weight in the order they are stored in the file
+    for (size_t i = 0; i < hiddenWeightCount; i++) {
+        if (!read_weight(fp, &evaluator->hiddenWeights[i])) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < hiddenSize; i++) {
+        if (!read_weight(fp, &evaluator->hiddenBiases[i])) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < outputSize; i++) {
+        if (!read_weight(fp, &evaluator->outputWeights[i])) {
+            return 0;
+        }
+    }
+    if (!read_weight(fp, &evaluator->outputBias)) {
+        return 0;
+    }
+    char c;
+    return fscanf(fp, " %c", &c) == EOF ? 1 : 0;
+}
+
+/**
+ * Reads the next weight or bias from a weights file.
+ * @param fp pointer to the weights file to read from.
+ * @param weight pointer to the variable in which to store the weight.
+ * @return 1 if a finite number was read, else 0 (e.g. for "nan" or "inf").
+ */
+int read_weight(FILE *fp, float *weight) {
+    return fscanf(fp, "%f", weight) == 1 && isfinite(*weight) ? 1 : 0;
+}
+
+/**
+ * Frees this evaluator and all of its weights. Does nothing if NULL.
+ * @param evaluator pointer to the evaluator to free.
+ */
+void free_evaluator(Evaluator *evaluator) {
+    if (evaluator == NULL) {
+        return;
+    }
+    free(evaluator->hiddenWeights);
+    free(evaluator->hiddenBiases);
+    free(evaluator->outputWeights);
+    free(evaluator);
+}
+
+/**
+ * Gets the current time of a monotonic clock, unaffected by changes to the
+ * system time.
+ * @return the current time in microseconds.
+ */
+long get_time_micros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+/**
+ * Adds the latency of an automated move to this latency log, counting it as
+ * an overrun if it exceeded the given time budget.
+ * @param latencyLog pointer to the log to record the latency in.
+ * @param latency the time taken to make the move, in microseconds.
+ * @param budget the time budget for the move, in microseconds, or 0 if the
+ * move had no budget.
+ */
+void record_latency(LatencyLog *latencyLog, long latency, long budget) {
+    if (latencyLog->count == latencyLog->capacity) {
+        latencyLog->capacity = latencyLog->capacity ?
+                latencyLog->capacity * 2 : 64;
+        latencyLog->samples = realloc(latencyLog->samples,
+                latencyLog->capacity * sizeof(long));
+    }
+    latencyLog->samples[latencyLog->count++] = latency;
+    if (budget > 0) {
+        latencyLog->budgetedCount++;
+        if (latency > budget) {
+            latencyLog->overruns++;
+        }
+    }
+}
+
+/**
+ * Compares two longs for sorting in ascending order with qsort.
+ * @param a pointer to the first long.
+ * @param b pointer to the second long.
+ * @return a negative, zero or positive value if a is less than, equal to or
+ * greater than b respectively.
+ */
+int compare_longs(const void *a, const void *b) {
+    long first = *(const long *) a;
+    long second = *(const long *) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * Prints the p50 and p99 latencies (by nearest rank) and number of budget
+ * overruns out of the moves with a budget in this latency log to the file
+ * pointed to by the given pointer. Prints nothing if no automated moves were
+ * made.
+ * Sorts the samples of the log in place.
+ * @param latencyLog the log to summarise.
+ * @param fp pointer to the file to print the summary to.
+ */
+void print_latency_summary(LatencyLog latencyLog, FILE *fp) {
+    int count = latencyLog.count;
+    if (count == 0) {
+        return;
+    }
+    qsort(latencyLog.samples, count, sizeof(long), compare_longs);
+    long p50 = latencyLog.samples[(count * 50 + 99) / 100 - 1];
+    long p99 = latencyLog.samples[(count * 99 + 99) / 100 - 1];
+    fprintf(fp, "Move latency: p50 %ldus p99 %ldus, %d/%d over budget\n",
+            p50, p99, latencyLog.overruns, latencyLog.budgetedCount);
+}
+
 /**
  * Checks whether this position represents a corner on this gameboard.
  * @param position to check.
@@ -737,3 +1579,235 @@ void save_file(GameBoard gameBoard, Player playerToAct, char *filename) {
     print_grid(gameBoard, fp);
     fclose(fp);
 }
+
+/**
+ * Calculates the immediate change in each player's score that would occur if
+ * the given player placed a stone at this position, without modifying the
+ * gameboard.
+ * Stones placed on an edge move one square inward along with every
+ * consecutive stone in front of them, exactly as in @shift_stones, so only
+ * the squares in this lane up until the first empty square are visited.
+ * Does not protect against invalid positions.
+ * @param playerIcon icon of the player placing the stone.
+ * @param position at which the stone would be placed.
+ * @param gameBoard on which the stone would be placed.
+ * @return the position along with the change in each player's score.
+ */
+MoveScore score_move(char playerIcon, Point position, GameBoard gameBoard) {
+    MoveScore moveScore = {position, 0, 0};
+    char direction = get_inward_direction(position, gameBoard);
+    if (!direction) {
+        // Interior stones are never pushed; the player gains this square
+        if (playerIcon == 'O') {
+            moveScore.deltaO = get_square(position, gameBoard).value;
+        } else {
+            moveScore.deltaX = get_square(position, gameBoard).value;
+        }
+        return moveScore;
+    }
+    // Walk the lane, moving each stone one square forward until the empty
+    // square is reached. The placed stone was not previously on the board,
+    // so it gains the full value of the square it is pushed into.
+    Point currentPosition = position;
+    char icon = playerIcon;
+    int currentValue = 0;
+    while (icon != '.') {
+        Point nextPosition = get_adjacent_position(
+                currentPosition, direction);
+        Square nextSquare = get_square(nextPosition, gameBoard);
+        if (icon == 'O') {
+            moveScore.deltaO += nextSquare.value - currentValue;
+        } else {
+            moveScore.deltaX += nextSquare.value - currentValue;
+        }
+        icon = nextSquare.playerIcon;
+        currentValue = nextSquare.value;
+        currentPosition = nextPosition;
+    }
+    return moveScore;
+}
+
+/**
+ * Scores every valid move the given player could make on this gameboard, in
+ * left-to-right, top-to-bottom order. See @score_move.
+ * @param playerIcon icon of the player to act.
+ * @param gameBoard on which to score moves.
+ * @param moveScores array in which to store the score of each valid move.
+ * Must have room for at least height * width entries.
+ * @return the number of valid moves found.
+ */
+int score_all_moves(char playerIcon, GameBoard gameBoard,
+        MoveScore *moveScores) {
+    int moveCount = 0;
+    for (int row = 0; row < gameBoard.height; row++) {
+        for (int column = 0; column < gameBoard.width; column++) {
+            Point position = {row, column};
+            if (is_valid_position(position, gameBoard)) {
+                moveScores[moveCount++] = score_move(
+                        playerIcon, position, gameBoard);
+            }
+        }
+    }
+    return moveCount;
+}
+
+/**
+ * Loads the save file of this batch entry and scores every legal move for
+ * the player to act, storing the results in the entry.
+ * @param entry pointer to the batch entry to score. Its filename must be set.
+ */
+void score_batch_entry(BatchEntry *entry) {
+    entry->moveScores = NULL;
+    entry->moveCount = 0;
+    FILE *fp = fopen(entry->filename, "r");
+    if (fp == NULL) {
+        entry->status = 3;
+        return;
+    }
+    if (!is_valid_save_file(fp)) {
+        entry->status = 4;
+        fclose(fp);
+        return;
+    }
+    int height, width;
+    Square **grid;
+    load_file(fp, &height, &width, &entry->playerToActIcon, &grid);
+    fclose(fp);
+    GameBoard gameBoard = {height, width, grid, NULL};
+    entry->moveScores = malloc(height * width * sizeof(MoveScore));
+    entry->moveCount = score_all_moves(entry->playerToActIcon, gameBoard,
+            entry->moveScores);
+    entry->status = 0;
+    free_grid(gameBoard);
+}
+
+/**
+ * Writes the results of this scored batch entry, then frees its move scores.
+ * Prints a line "fname playerToAct moveCount" to stdout, followed by one line
+ * "R C deltaO deltaX" per legal move, or reports the entry's error on stderr
+ * if it could not be scored.
+ * @param entry pointer to the batch entry to write.
+ */
+void write_batch_entry(BatchEntry *entry) {
+    if (entry->status == 3) {
+        fprintf(stderr, "No file to load from: %s\n", entry->filename);
+    } else if (entry->status == 4) {
+        fprintf(stderr, "Invalid file contents: %s\n", entry->filename);
+    } else {
+        printf("%s %c %d\n", entry->filename, entry->playerToActIcon,
+                entry->moveCount);
+        for (int i = 0; i < entry->moveCount; i++) {
+            MoveScore moveScore = entry->moveScores[i];
+            printf("%d %d %d %d\n", moveScore.position.row,
+                    moveScore.position.column, moveScore.deltaO,
+                    moveScore.deltaX);
+        }
+    }
+    free(entry->moveScores);
+    entry->moveScores = NULL;
+}
+
+/**
+ * Thread entry point which repeatedly claims the next unscored file of the
+ * batch queue and scores it, waiting whenever the ring buffer is full.
+ * @param arg pointer to the BatchQueue to take files from.
+ * @return NULL.
+ */
+void *score_batch(void *arg) {
+    BatchQueue *queue = arg;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->nextToClaim < queue->fileCount && queue->nextToClaim >=
+                queue->nextToWrite + queue->windowSize) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        }
+        if (queue->nextToClaim == queue->fileCount) {
+            pthread_mutex_unlock(&queue->lock);
+            return NULL;
+        }
+        int i = queue->nextToClaim++;
+        pthread_mutex_unlock(&queue->lock);
+
+        BatchEntry *entry = &queue->slots[i % queue->windowSize];
+        entry->filename = queue->filenames[i];
+        score_batch_entry(entry);
+
+        pthread_mutex_lock(&queue->lock);
+        entry->done = 1;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * Loads each of the given save files and scores every legal move for the
+ * player to act, spreading the files across one worker thread per online
+ * processor. See @write_batch_entry for the output format.
+ * Results are written in the order the files were passed, as soon as all
+ * earlier files have been written. Workers may only run a bounded number of
+ * files ahead of the writer, so memory use does not grow with batch size.
+ * If no worker thread can be started, files are scored on this thread.
+ * @param fileCount the number of save files to score.
+ * @param filenames names of the save files to score.
+ * @return 0 if every file was scored, 3 if a file could not be opened,
+ * else 4 if a file had invalid contents.
+ */
+int run_batch(int fileCount, char **filenames) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = processors < 1 ? 1 : (int) processors;
+    if (threadCount > fileCount) {
+        threadCount = fileCount;
+    }
+    BatchQueue queue;
+    queue.filenames = filenames;
+    queue.fileCount = fileCount;
+    queue.windowSize = threadCount * 4;
+    queue.slots = calloc(queue.windowSize, sizeof(BatchEntry));
+    queue.nextToClaim = 0;
+    queue.nextToWrite = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.changed, NULL);
+
+    // Start the workers, continuing with however many could be started
+    pthread_t *threads = malloc(threadCount * sizeof(pthread_t));
+    int workerCount = 0;
+    while (workerCount < threadCount && !pthread_create(
+            &threads[workerCount], NULL, score_batch, &queue)) {
+        workerCount++;
+    }
+
+    // Write results in the order the files were passed
+    int status = 0;
+    for (int i = 0; i < fileCount; i++) {
+        BatchEntry *entry = &queue.slots[i % queue.windowSize];
+        if (workerCount == 0) {
+            entry->filename = filenames[i];
+            score_batch_entry(entry);
+        } else {
+            pthread_mutex_lock(&queue.lock);
+            while (!entry->done) {
+                pthread_cond_wait(&queue.changed, &queue.lock);
+            }
+            pthread_mutex_unlock(&queue.lock);
+        }
+        write_batch_entry(entry);
+        if (entry->status == 3 || (entry->status == 4 && !status)) {
+            status = entry->status;
+        }
+        // Free this slot for the file windowSize places ahead
+        pthread_mutex_lock(&queue.lock);
+        entry->done = 0;
+        queue.nextToWrite++;
+        pthread_cond_broadcast(&queue.changed);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_cond_destroy(&queue.changed);
+    pthread_mutex_destroy(&queue.lock);
+    free(threads);
+    free(queue.slots);
+    return status;
+}